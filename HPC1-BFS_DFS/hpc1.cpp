@@ -12,7 +12,12 @@ Measure the performance of sequential and parallel algorithms.
 #include <stack>
 #include <queue>
 #include <chrono>
+#include <atomic>
+#include <mutex>
 #include <omp.h>
+#include "../common/benchmark.h"
+#include "../common/thread_pool.h"
+#include "../common/verify.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -36,6 +41,16 @@ class graph
         adj[v].push_back(u);
     }
 
+    long edgeCount()
+    {
+        long degrees=0;
+        for(auto &neighbors:adj)
+        {
+            degrees+=neighbors.size();
+        }
+        return degrees/2;
+    }
+
     void sequentialBFS(int start, vector<int> &sbfsSequence)
     {
         vector<bool> visited(v,false);
@@ -61,9 +76,11 @@ class graph
         }
     }
 
+    // visited is read outside the critical section, so it has to be atomic:
+    // concurrent access to neighboring vector<bool> bits is a data race.
     void parallelBFS(int start, vector<int> &pbfsSequence)
     {
-        vector<bool> visited(v,false);
+        vector<atomic<bool>> visited(v);
         queue<int> q;
 
         q.push(start);
@@ -82,24 +99,33 @@ class graph
                 current_level.push_back(node);
             }
 
-            #pragma omp parallel for
-            for(int i=0;i<current_level.size();i++)
+            #pragma omp parallel
             {
-                int node=current_level[i];
-                for(auto neighbor : adj[node])
+                HPC_PERF_THREAD();
+
+                #pragma omp for nowait
+                for(int i=0;i<current_level.size();i++)
                 {
-                    if(!visited[neighbor])
+                    int node=current_level[i];
+                    for(auto neighbor : adj[node])
                     {
-                        #pragma omp critical
+                        if(!visited[neighbor].load(memory_order_relaxed))
                         {
-                            if(!visited[neighbor])
+                            HPC_PERF_WAIT_START(waitStart);
+                            #pragma omp critical
                             {
-                                q.push(neighbor);
-                                visited[neighbor]=true;
+                                HPC_PERF_WAIT_STOP(waitStart);
+                                if(!visited[neighbor])
+                                {
+                                    q.push(neighbor);
+                                    visited[neighbor]=true;
+                                }
                             }
                         }
                     }
                 }
+
+                HPC_PERF_BARRIER();
             }
         }
     }
@@ -140,7 +166,7 @@ class graph
 
     void parallelDFS(int start, vector<int> &pdfsSequence)
     {
-        vector<bool> visited(v,false);
+        vector<atomic<bool>> visited(v);
         stack<int> s;
 
         s.push(start);
@@ -152,13 +178,141 @@ class graph
             s.pop();
             pdfsSequence.push_back(node);
 
-            #pragma omp parallel for
-            for(auto neighbor:adj[node])
+            #pragma omp parallel
             {
-                if(!visited[neighbor])
+                HPC_PERF_THREAD();
+
+                #pragma omp for nowait
+                for(auto neighbor:adj[node])
                 {
-                    #pragma omp critical
+                    if(!visited[neighbor].load(memory_order_relaxed))
                     {
+                        HPC_PERF_WAIT_START(waitStart);
+                        #pragma omp critical
+                        {
+                            HPC_PERF_WAIT_STOP(waitStart);
+                            if(!visited[neighbor])
+                            {
+                                s.push(neighbor);
+                                visited[neighbor]=true;
+                            }
+                        }
+                    }
+                }
+
+                HPC_PERF_BARRIER();
+            }
+        }
+    }
+
+    // parallelBFS ported to the persistent pool unchanged: the level loop is a
+    // tp::parallel_for and the critical section a mutex. A level only splits
+    // when it has more than the pool's grain of nodes.
+    void poolBFS(int start, vector<int> &pbfsSequence)
+    {
+        vector<atomic<bool>> visited(v);
+        queue<int> q;
+        mutex queueLock;
+
+        q.push(start);
+        visited[start]=true;
+
+        while(!q.empty())
+        {
+            int size=q.size();
+            vector<int> current_level;
+
+            for(int i=0;i<size;i++)
+            {
+                int node=q.front();
+                q.pop();
+                pbfsSequence.push_back(node);
+                current_level.push_back(node);
+            }
+
+            tp::parallel_for(0,current_level.size(),[&](long lo,long hi)
+            {
+                for(long i=lo;i<hi;i++)
+                {
+                    for(auto neighbor:adj[current_level[i]])
+                    {
+                        if(!visited[neighbor].load(memory_order_relaxed))
+                        {
+                            lock_guard<mutex> guard(queueLock);
+                            if(!visited[neighbor])
+                            {
+                                q.push(neighbor);
+                                visited[neighbor]=true;
+                            }
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    // poolBFS with a different algorithm: each chunk of the frontier claims
+    // neighbors with an atomic exchange and appends them to the next frontier
+    // once, instead of taking a lock per neighbor.
+    void poolFrontierBFS(int start, vector<int> &pbfsSequence)
+    {
+        vector<atomic<bool>> visited(v);
+        vector<int> frontier={start};
+        visited[start]=true;
+
+        while(!frontier.empty())
+        {
+            pbfsSequence.insert(pbfsSequence.end(),frontier.begin(),frontier.end());
+
+            vector<int> next;
+            mutex nextLock;
+            tp::parallel_for(0,frontier.size(),[&](long lo,long hi)
+            {
+                vector<int> local;
+                for(long i=lo;i<hi;i++)
+                {
+                    for(auto neighbor:adj[frontier[i]])
+                    {
+                        if(!visited[neighbor].load(memory_order_relaxed) && !visited[neighbor].exchange(true))
+                        {
+                            local.push_back(neighbor);
+                        }
+                    }
+                }
+
+                lock_guard<mutex> guard(nextLock);
+                next.insert(next.end(),local.begin(),local.end());
+            });
+
+            frontier.swap(next);
+        }
+    }
+
+    // parallelDFS ported to the pool unchanged. The neighbor loop of a node only
+    // splits above the pool's grain, so on low-degree graphs this runs inline.
+    void poolDFS(int start, vector<int> &pdfsSequence)
+    {
+        vector<atomic<bool>> visited(v);
+        stack<int> s;
+        mutex stackLock;
+
+        s.push(start);
+        visited[start]=true;
+
+        while(!s.empty())
+        {
+            int node=s.top();
+            s.pop();
+            pdfsSequence.push_back(node);
+
+            tp::parallel_for(0,adj[node].size(),[&](long lo,long hi)
+            {
+                for(long i=lo;i<hi;i++)
+                {
+                    int neighbor=adj[node][i];
+                    if(!visited[neighbor].load(memory_order_relaxed))
+                    {
+                        lock_guard<mutex> guard(stackLock);
                         if(!visited[neighbor])
                         {
                             s.push(neighbor);
@@ -166,8 +320,36 @@ class graph
                         }
                     }
                 }
+            });
+        }
+    }
+
+    // Hop distance of every node from start, -1 if unreachable. This is the
+    // reference the traversals are checked against in --verify.
+    vector<int> levels(int start)
+    {
+        vector<int> level(v,-1);
+        queue<int> q;
+
+        q.push(start);
+        level[start]=0;
+
+        while(!q.empty())
+        {
+            int node=q.front();
+            q.pop();
+
+            for(auto neighbor:adj[node])
+            {
+                if(level[neighbor]<0)
+                {
+                    level[neighbor]=level[node]+1;
+                    q.push(neighbor);
+                }
             }
         }
+
+        return level;
     }
 
     void print(vector<int> &v)
@@ -183,79 +365,264 @@ class graph
     }
 };
 
-int main()
+// --verify: every traversal on random graphs must start at the start node and
+// visit exactly the nodes reachable from it, once each; BFS orders must also
+// be non-decreasing in hop distance.
+int verify(const bench::Options &opts)
 {
-    int v=100000;
-    graph g(v);
-    for(int i=0;i<v;i++)
+    check::Suite suite("hpc1",opts);
+    const char *shapes[]={"random","path+chords","star","dense","forest"};
+
+    suite.sweep([&](int round)
     {
-        g.addEdge(i,i+1);
+        int shape=round%5;
+        int v=suite.uniform(1,shape==3 ? 300 : 2000);
+        graph g(v);
 
-        if(i%100==0 && i+100<v)
+        if(shape==0)
         {
-            g.addEdge(i,i+100);
+            int edges=suite.uniform(0,3*v);
+            for(int e=0;e<edges;e++)
+            {
+                g.addEdge(suite.uniform(0,v-1),suite.uniform(0,v-1));
+            }
         }
+        else if(shape==1)
+        {
+            for(int i=0;i+1<v;i++)
+            {
+                g.addEdge(i,i+1);
+                if(suite.uniform(0,9)==0)
+                {
+                    g.addEdge(i,suite.uniform(0,v-1));
+                }
+            }
+        }
+        else if(shape==2)
+        {
+            // A hub whose degree exceeds the pool's grain, so its neighbor loop splits.
+            for(int i=1;i<v;i++)
+            {
+                g.addEdge(0,i);
+                if(suite.uniform(0,3)==0)
+                {
+                    g.addEdge(i,suite.uniform(1,v-1));
+                }
+            }
+        }
+        else if(shape==3)
+        {
+            for(int i=0;i<v;i++)
+            {
+                for(int j=i+1;j<v;j++)
+                {
+                    if(suite.uniform(0,1))
+                    {
+                        g.addEdge(i,j);
+                    }
+                }
+            }
+        }
+        else
+        {
+            for(int i=1;i<v;i++)
+            {
+                if(suite.uniform(0,4))
+                {
+                    g.addEdge(suite.uniform(0,i-1),i);
+                }
+            }
+        }
+
+        int start=suite.uniform(0,v-1);
+        vector<int> level=g.levels(start);
+        vector<int> reachable;
+        for(int i=0;i<v;i++)
+        {
+            if(level[i]>=0)
+            {
+                reachable.push_back(i);
+            }
+        }
+
+        auto visitsReachable=[&](vector<int> sequence)
+        {
+            bool startsRight=!sequence.empty() && sequence[0]==start;
+            sort(sequence.begin(),sequence.end());
+            return startsRight && sequence==reachable;
+        };
+
+        auto checkBFS=[&](const char *name,void (graph::*bfs)(int,vector<int>&))
+        {
+            if(!suite.wants(name))
+            {
+                return;
+            }
+
+            vector<int> sequence;
+            (g.*bfs)(start,sequence);
+            bool ok=visitsReachable(sequence);
+            for(int i=1;ok && i<(int)sequence.size();i++)
+            {
+                ok=level[sequence[i-1]]<=level[sequence[i]];
+            }
+            suite.expect(ok,check::describe(name,v,shapes[shape]));
+        };
+
+        auto checkDFS=[&](const char *name,void (graph::*dfs)(int,vector<int>&))
+        {
+            if(!suite.wants(name))
+            {
+                return;
+            }
+
+            vector<int> sequence;
+            (g.*dfs)(start,sequence);
+            suite.expect(visitsReachable(sequence),check::describe(name,v,shapes[shape]));
+        };
+
+        checkBFS("Sequential BFS",&graph::sequentialBFS);
+        checkBFS("Parallel BFS",&graph::parallelBFS);
+        checkBFS("Pool BFS",&graph::poolBFS);
+        checkBFS("Pool Frontier BFS",&graph::poolFrontierBFS);
+        checkDFS("Sequential DFS",&graph::sequentialDFS);
+        checkDFS("Parallel DFS",&graph::parallelDFS);
+        checkDFS("Pool DFS",&graph::poolDFS);
+    });
+
+    return suite.finish();
+}
+
+int main(int argc, char **argv)
+{
+    // ./output1 [--sizes=100000] [--graph=chain|star] [--threads=1,2,4] [--format=text|json|csv] (see common/benchmark.h)
+    // ./output1 --verify [--threads=4] [--rounds=20] [--seed=1] (see common/verify.h)
+    bench::Options opts;
+    if(!bench::parseOptions(argc,argv,opts,{100000}))
+    {
+        return 1;
+    }
+    if(opts.has("verify"))
+    {
+        return verify(opts);
     }
+    bench::Report report("hpc1",opts);
+
+    bench::sweep(opts,[&](long size)
+    {
+        // --graph=star adds an edge from node 0 to every node, so BFS level 1
+        // and node 0's DFS neighbor loop are wide enough to run in parallel.
+        int v=size;
+        bool star=opts.str("graph","chain")=="star";
+        graph g(v);
+        for(int i=0;i<v;i++)
+        {
+            if(i+1<v)
+            {
+                g.addEdge(i,i+1);
+            }
+
+            if(i%100==0 && i+100<v)
+            {
+                g.addEdge(i,i+100);
+            }
 
-    // int v=7;
-    // graph g(v);
-    // g.addEdge(0,1);
-    // g.addEdge(0,2);
-    // g.addEdge(1,3);
-    // g.addEdge(1,4);
-    // g.addEdge(2,5);
-    // g.addEdge(2,6);
-
-    vector<int> sbfsSequence;
-    vector<int> pbfsSequence;
-    vector<int> sdfsSequence;
-    vector<int> pdfsSequence;
-
-
-    auto start=high_resolution_clock::now();
-    g.sequentialBFS(0,sbfsSequence);
-    auto end=high_resolution_clock::now();
-    cout<<"Sequential BFS Time: "<<duration_cast<milliseconds>(end-start).count()<<" ms \n";
-    cout<<"Sequential BFS Traversal: "<<endl;
-    g.print(sbfsSequence);
-    cout<<endl;
-
-    cout<<endl;
-
-    start=high_resolution_clock::now();
-    g.parallelBFS(0,pbfsSequence);
-    end=high_resolution_clock::now();
-    cout<<"Parallel BFS Time: "<<duration_cast<milliseconds>(end-start).count()<<" ms \n";
-    cout<<"Parallel BFS Traversal: "<<endl;
-    g.print(pbfsSequence);
-    cout<<endl;
-
-    cout<<endl;
-
-    start=high_resolution_clock::now();
-    g.sequentialDFS(0,sdfsSequence);
-    end=high_resolution_clock::now();
-    cout<<"Sequential DFS Time: "<<duration_cast<milliseconds>(end-start).count()<<" ms \n";
-    cout<<"Sequential DFS Traversal: "<<endl;
-    g.print(sdfsSequence);
-    cout<<endl;
-
-    cout<<endl;
-
-    start=high_resolution_clock::now();
-    g.parallelDFS(0,pdfsSequence);
-    end=high_resolution_clock::now();
-    cout<<"Parallel DFS Time: "<<duration_cast<milliseconds>(end-start).count()<<" ms \n";
-    cout<<"Parallel DFS Traversal: "<<endl;
-    g.print(pbfsSequence);
-    cout<<endl;
+            if(star && i>1)
+            {
+                g.addEdge(0,i);
+            }
+        }
+        long edges=g.edgeCount();
+
+        // int v=7;
+        // graph g(v);
+        // g.addEdge(0,1);
+        // g.addEdge(0,2);
+        // g.addEdge(1,3);
+        // g.addEdge(1,4);
+        // g.addEdge(2,5);
+        // g.addEdge(2,6);
+
+        vector<int> sbfsSequence;
+        vector<int> pbfsSequence;
+        vector<int> sdfsSequence;
+        vector<int> pdfsSequence;
+        vector<int> tbfsSequence;
+        vector<int> tdfsSequence;
+
+        report.run("Sequential BFS",v,edges,"edges/s",[&]{ g.sequentialBFS(0,sbfsSequence); },[&]{ sbfsSequence.clear(); });
+        if(opts.text())
+        {
+            cout<<"Sequential BFS Traversal: "<<endl;
+            g.print(sbfsSequence);
+            cout<<endl<<endl;
+        }
 
+        report.run("Parallel BFS",v,edges,"edges/s",[&]{ g.parallelBFS(0,pbfsSequence); },[&]{ pbfsSequence.clear(); });
+        if(opts.text())
+        {
+            cout<<"Parallel BFS Traversal: "<<endl;
+            g.print(pbfsSequence);
+            cout<<endl<<endl;
+        }
+
+        report.run("Pool BFS",v,edges,"edges/s",[&]{ g.poolBFS(0,tbfsSequence); },[&]{ tbfsSequence.clear(); });
+        if(opts.text())
+        {
+            cout<<"Pool BFS Traversal: "<<endl;
+            g.print(tbfsSequence);
+            cout<<endl<<endl;
+        }
+
+        report.run("Pool Frontier BFS",v,edges,"edges/s",[&]{ g.poolFrontierBFS(0,tbfsSequence); },[&]{ tbfsSequence.clear(); });
+        if(opts.text())
+        {
+            cout<<"Pool Frontier BFS Traversal: "<<endl;
+            g.print(tbfsSequence);
+            cout<<endl<<endl;
+        }
 
+        report.run("Sequential DFS",v,edges,"edges/s",[&]{ g.sequentialDFS(0,sdfsSequence); },[&]{ sdfsSequence.clear(); });
+        if(opts.text())
+        {
+            cout<<"Sequential DFS Traversal: "<<endl;
+            g.print(sdfsSequence);
+            cout<<endl<<endl;
+        }
+
+        report.run("Parallel DFS",v,edges,"edges/s",[&]{ g.parallelDFS(0,pdfsSequence); },[&]{ pdfsSequence.clear(); });
+        if(opts.text())
+        {
+            cout<<"Parallel DFS Traversal: "<<endl;
+            g.print(pdfsSequence);
+            cout<<endl<<endl;
+        }
+
+        report.run("Pool DFS",v,edges,"edges/s",[&]{ g.poolDFS(0,tdfsSequence); },[&]{ tdfsSequence.clear(); });
+        if(opts.text())
+        {
+            cout<<"Pool DFS Traversal: "<<endl;
+            g.print(tdfsSequence);
+            cout<<endl<<endl;
+        }
+    });
+
+    report.finish();
     return 0;
 }
 
 
 /*
+Build & benchmark options:-
+g++-14 -O2 -fopenmp -o output1 hpc1.cpp
+./output1 --sizes=10000,100000 --threads=1,2,4 --format=json --output=hpc1.json
+
+With hardware counters and per-thread work/wait times (Linux):-
+g++-14 -O2 -fopenmp -DHPC_PERF -o output1 hpc1.cpp
+
+The "Pool" cases run on common/thread_pool.h. --verify and the ThreadSanitizer
+build are described in common/verify.h.
+
 Output 1:-
 g++-14 -fopenmp -o output1 hpc1.cpp
 ./output1                          
@@ -10,6 +10,9 @@ existing algorithms and measure the performance of sequential and parallel algor
 #include <vector>
 #include <chrono>
 #include <omp.h>
+#include "../common/benchmark.h"
+#include "../common/thread_pool.h"
+#include "../common/verify.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -38,24 +41,38 @@ void parallelBubbleSort(vector<int> &v)
     {
         if(i%2==0)
         {
-            #pragma omp parallel for
-            for(int j=0;j<n-1;j+=2)
+            #pragma omp parallel
             {
-                if(v[j]>v[j+1])
+                HPC_PERF_THREAD();
+
+                #pragma omp for nowait
+                for(int j=0;j<n-1;j+=2)
                 {
-                    swap(v[j],v[j+1]);
+                    if(v[j]>v[j+1])
+                    {
+                        swap(v[j],v[j+1]);
+                    }
                 }
+
+                HPC_PERF_BARRIER();
             }
         }
         else
         {
-            #pragma omp parallel for
-            for(int j=1;j<n-1;j+=2)
+            #pragma omp parallel
             {
-                if(v[j]>v[j+1])
+                HPC_PERF_THREAD();
+
+                #pragma omp for nowait
+                for(int j=1;j<n-1;j+=2)
                 {
-                    swap(v[j],v[j+1]);
+                    if(v[j]>v[j+1])
+                    {
+                        swap(v[j],v[j+1]);
+                    }
                 }
+
+                HPC_PERF_BARRIER();
             }
         }
     }
@@ -125,17 +142,24 @@ void parallelMergeSort(vector<int> &v, int low, int high, int depth=0)
 
     if(depth<=3)
     {
-        #pragma omp parallel sections
+        #pragma omp parallel
         {
-            #pragma omp section
-            {
-                parallelMergeSort(v,low,mid,depth+1);
-            }
+            HPC_PERF_THREAD();
 
-            #pragma omp section
+            #pragma omp sections nowait
             {
-                parallelMergeSort(v,mid+1,high,depth+1);
+                #pragma omp section
+                {
+                    parallelMergeSort(v,low,mid,depth+1);
+                }
+
+                #pragma omp section
+                {
+                    parallelMergeSort(v,mid+1,high,depth+1);
+                }
             }
+
+            HPC_PERF_BARRIER();
         }
     }
     else
@@ -147,6 +171,53 @@ void parallelMergeSort(vector<int> &v, int low, int high, int depth=0)
     merge(v,low,mid,high);
 }
 
+// Odd-even sort on the persistent pool: each phase is a parallel_for, which
+// runs inline when the phase is too small to split.
+void poolBubbleSort(vector<int> &v)
+{
+    int n=v.size();
+
+    for(int i=0;i<n;i++)
+    {
+        int first=i%2;
+        long pairs=(n-first)/2;
+
+        tp::parallel_for(0,pairs,[&](long lo,long hi)
+        {
+            for(long k=lo;k<hi;k++)
+            {
+                int j=first+2*k;
+                if(v[j]>v[j+1])
+                {
+                    swap(v[j],v[j+1]);
+                }
+            }
+        });
+    }
+}
+
+// Fork-join merge sort on the pool; ranges below poolSortCutoff are sorted
+// sequentially instead of becoming tasks.
+const int poolSortCutoff=2048;
+
+void poolMergeSort(vector<int> &v, int low, int high)
+{
+    if(high-low<poolSortCutoff)
+    {
+        sequentialMergeSort(v,low,high);
+        return;
+    }
+
+    int mid=(low+high)/2;
+
+    tp::TaskGroup halves;
+    halves.run([&]{ poolMergeSort(v,low,mid); });
+    poolMergeSort(v,mid+1,high);
+    halves.wait();
+
+    merge(v,low,mid,high);
+}
+
 void print(vector<int> &v)
 {
     int limit=min((int)v.size(),50);
@@ -160,60 +231,124 @@ void print(vector<int> &v)
 }
 
 
-
-int main()
+// --verify: every sort must produce the same output as std::sort. Every
+// fourth round uses a tiny array (0-8 elements) to cover the boundaries of
+// the odd-even phases and the merge recursion.
+int verify(const bench::Options &opts)
 {
-    int size=10000;
-    vector<int> temp;
+    check::Suite suite("hpc2",opts);
+
+    suite.sweep([&](int round)
+    {
+        bool tiny=round%4==0;
+        check::Layout layout=check::Layout(suite.uniform(0,int(check::Layout::Count)-1));
+        int bubbleSize=tiny ? suite.uniform(0,8) : suite.uniform(9,1500);
+        int mergeSize=tiny ? bubbleSize : suite.uniform(9,40000);
 
-    // vector<int> v={10,9,8,7,6,5,4,3,2,1,0};
+        auto checkSort=[&](const char *name,int n,const function<void(vector<int>&)> &sort)
+        {
+            if(!suite.wants(name))
+            {
+                return;
+            }
+
+            vector<int> v=check::randomArray(suite,n,layout);
+            vector<int> expected=v;
+            std::sort(expected.begin(),expected.end());
+            sort(v);
+            suite.expect(v==expected,check::describe(name,n,check::layoutName(layout)));
+        };
+
+        checkSort("Sequential Bubble Sort",bubbleSize,[](vector<int> &v){ sequentialBubbleSort(v); });
+        checkSort("Parallel Bubble Sort",bubbleSize,[](vector<int> &v){ parallelBubbleSort(v); });
+        checkSort("Pool Bubble Sort",bubbleSize,[](vector<int> &v){ poolBubbleSort(v); });
+        checkSort("Sequential Merge Sort",mergeSize,[](vector<int> &v){ sequentialMergeSort(v,0,v.size()-1); });
+        checkSort("Parallel Merge Sort",mergeSize,[](vector<int> &v){ parallelMergeSort(v,0,v.size()-1); });
+        checkSort("Pool Merge Sort",mergeSize,[](vector<int> &v){ poolMergeSort(v,0,v.size()-1); });
+    });
+
+    return suite.finish();
+}
 
-    vector<int> v(size);
-    for(int i=0;i<size;i++)
+int main(int argc, char **argv)
+{
+    // ./output2 [--sizes=10000] [--threads=1,2,4] [--format=text|json|csv] (see common/benchmark.h)
+    // ./output2 --verify [--threads=4] [--rounds=20] [--seed=1] (see common/verify.h)
+    bench::Options opts;
+    if(!bench::parseOptions(argc,argv,opts,{10000}))
+    {
+        return 1;
+    }
+    if(opts.has("verify"))
     {
-        v[i]=size-i;
+        return verify(opts);
     }
+    bench::Report report("hpc2",opts);
+
+    bench::sweep(opts,[&](long size)
+    {
+        vector<int> temp;
 
-    temp=v;
-    auto start=high_resolution_clock::now();
-    sequentialBubbleSort(temp);
-    auto end=high_resolution_clock::now();
-    cout<<"Sequential Bubble Sort Time: "<<duration_cast<milliseconds>(end-start).count()<<" ms\n";
-    cout<<"Sequential Bubble Sort Array: "<<endl;
-    print(temp);
-    cout<<endl;
-    cout<<endl;
-
-    temp=v;
-    start=high_resolution_clock::now();
-    parallelBubbleSort(temp);
-    end=high_resolution_clock::now();
-    cout<<"Parallel Bubble Sort Time: "<<duration_cast<milliseconds>(end-start).count()<<" ms\n";
-    cout<<"Parallel Bubble Sort Array: "<<endl;
-    print(temp);
-    cout<<endl;
-    cout<<endl;
-
-    temp=v;
-    start=high_resolution_clock::now();
-    sequentialMergeSort(temp,0,temp.size()-1);
-    end=high_resolution_clock::now();
-    cout<<"Sequential Merge Sort Time: "<<duration_cast<milliseconds>(end-start).count()<<" ms\n";
-    cout<<"Sequential Merge Sort Array: "<<endl;
-    print(temp);
-    cout<<endl;
-    cout<<endl;
-
-    temp=v;
-    start=high_resolution_clock::now();
-    parallelMergeSort(temp,0,temp.size()-1);
-    end=high_resolution_clock::now();
-    cout<<"Parallel Merge Sort Time: "<<duration_cast<milliseconds>(end-start).count()<<" ms\n";
-    cout<<"Parallel Merge Sort Array: "<<endl;
-    print(temp);
-    cout<<endl;
-    cout<<endl;
+        // vector<int> v={10,9,8,7,6,5,4,3,2,1,0};
 
+        vector<int> v(size);
+        for(int i=0;i<size;i++)
+        {
+            v[i]=size-i;
+        }
+
+        auto restore=[&]{ temp=v; };
+
+        report.run("Sequential Bubble Sort",size,size,"elements/s",[&]{ sequentialBubbleSort(temp); },restore);
+        if(opts.text())
+        {
+            cout<<"Sequential Bubble Sort Array: "<<endl;
+            print(temp);
+            cout<<endl<<endl;
+        }
+
+        report.run("Parallel Bubble Sort",size,size,"elements/s",[&]{ parallelBubbleSort(temp); },restore);
+        if(opts.text())
+        {
+            cout<<"Parallel Bubble Sort Array: "<<endl;
+            print(temp);
+            cout<<endl<<endl;
+        }
+
+        report.run("Pool Bubble Sort",size,size,"elements/s",[&]{ poolBubbleSort(temp); },restore);
+        if(opts.text())
+        {
+            cout<<"Pool Bubble Sort Array: "<<endl;
+            print(temp);
+            cout<<endl<<endl;
+        }
+
+        report.run("Sequential Merge Sort",size,size,"elements/s",[&]{ sequentialMergeSort(temp,0,temp.size()-1); },restore);
+        if(opts.text())
+        {
+            cout<<"Sequential Merge Sort Array: "<<endl;
+            print(temp);
+            cout<<endl<<endl;
+        }
+
+        report.run("Parallel Merge Sort",size,size,"elements/s",[&]{ parallelMergeSort(temp,0,temp.size()-1); },restore);
+        if(opts.text())
+        {
+            cout<<"Parallel Merge Sort Array: "<<endl;
+            print(temp);
+            cout<<endl<<endl;
+        }
+
+        report.run("Pool Merge Sort",size,size,"elements/s",[&]{ poolMergeSort(temp,0,temp.size()-1); },restore);
+        if(opts.text())
+        {
+            cout<<"Pool Merge Sort Array: "<<endl;
+            print(temp);
+            cout<<endl<<endl;
+        }
+    });
+
+    report.finish();
     return 0;
 }
 
@@ -222,6 +357,16 @@ int main()
 
 
 /*
+Build & benchmark options:-
+g++-14 -O2 -fopenmp -o output2 hpc2.cpp
+./output2 --sizes=1000,10000 --threads=1,2,4 --format=json --output=hpc2.json
+
+With hardware counters and per-thread work/wait times (Linux):-
+g++-14 -O2 -fopenmp -DHPC_PERF -o output2 hpc2.cpp
+
+The "Pool" cases run on common/thread_pool.h. --verify and the ThreadSanitizer
+build are described in common/verify.h.
+
 Output-1:-
 g++-14 -fopenmp -o output2 hpc2.cpp
 ./output2                       
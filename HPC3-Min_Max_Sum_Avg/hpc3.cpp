@@ -12,6 +12,9 @@ Measure the performance of sequential and parallel algorithms.
 #include<algorithm>
 #include<omp.h>
 #include<chrono>
+#include "../common/benchmark.h"
+#include "../common/thread_pool.h"
+#include "../common/verify.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -44,10 +47,17 @@ void parallel_min(vector<int> &v,int &min_value)
 {
     min_value=INT_MAX;
 
-    #pragma omp parallel for reduction(min:min_value)
-    for(int i=0;i<v.size();i++)
+    #pragma omp parallel
     {
-        min_value=min(min_value,v[i]);
+        HPC_PERF_THREAD();
+
+        #pragma omp for reduction(min:min_value) nowait
+        for(int i=0;i<v.size();i++)
+        {
+            min_value=min(min_value,v[i]);
+        }
+
+        HPC_PERF_BARRIER();
     }
 }
 
@@ -55,20 +65,34 @@ void parallel_max(vector<int> &v,int &max_value)
 {
     max_value=INT_MIN;
 
-    #pragma omp parallel for reduction(max:max_value)
-    for(int i=0;i<v.size();i++)
+    #pragma omp parallel
     {
-        max_value=max(max_value,v[i]);
+        HPC_PERF_THREAD();
+
+        #pragma omp for reduction(max:max_value) nowait
+        for(int i=0;i<v.size();i++)
+        {
+            max_value=max(max_value,v[i]);
+        }
+
+        HPC_PERF_BARRIER();
     }
 }
 
 long long parallel_sum(vector<int> &v)
 {
     long long sum=0;
-    #pragma omp parallel for reduction(+:sum)
-    for(int i=0;i<v.size();i++)
+    #pragma omp parallel
     {
-        sum+=v[i];
+        HPC_PERF_THREAD();
+
+        #pragma omp for reduction(+:sum) nowait
+        for(int i=0;i<v.size();i++)
+        {
+            sum+=v[i];
+        }
+
+        HPC_PERF_BARRIER();
     }
 
     return sum;
@@ -80,89 +104,233 @@ void parallel_avg(vector<int> &v,double &avg)
     avg=double(sum)/v.size();
 }
 
-int main()
+// The same reductions on the persistent pool: one fork-join tree per call
+// instead of an OpenMP region.
+void pool_min(vector<int> &v,int &min_value)
+{
+    min_value=tp::parallel_reduce(0,v.size(),INT_MAX,[&](long lo,long hi,int acc)
+    {
+        for(long i=lo;i<hi;i++)
+        {
+            acc=min(acc,v[i]);
+        }
+        return acc;
+    },[](int a,int b){ return min(a,b); });
+}
+
+void pool_max(vector<int> &v,int &max_value)
+{
+    max_value=tp::parallel_reduce(0,v.size(),INT_MIN,[&](long lo,long hi,int acc)
+    {
+        for(long i=lo;i<hi;i++)
+        {
+            acc=max(acc,v[i]);
+        }
+        return acc;
+    },[](int a,int b){ return max(a,b); });
+}
+
+long long pool_sum(vector<int> &v)
+{
+    return tp::parallel_reduce(0,v.size(),0ll,[&](long lo,long hi,long long acc)
+    {
+        for(long i=lo;i<hi;i++)
+        {
+            acc+=v[i];
+        }
+        return acc;
+    },[](long long a,long long b){ return a+b; });
+}
+
+void pool_avg(vector<int> &v,double &avg)
+{
+    long long sum=pool_sum(v);
+    avg=double(sum)/v.size();
+}
+
+// --verify: the parallel and pool reductions must return exactly what the
+// sequential ones do (integer sums are exact, so the averages must match too).
+// The extremes layout makes partial sums leave the int range.
+int verify(const bench::Options &opts)
 {
-    // vector<int> v={10,9,8,7,6,5,4,3,2,1};
+    check::Suite suite("hpc3",opts);
+
+    suite.sweep([&](int round)
+    {
+        check::Layout layout=check::Layout(suite.uniform(0,int(check::Layout::Count)-1));
+        int size=round%4==0 ? suite.uniform(1,8) : suite.uniform(9,1<<20);
+        vector<int> v=check::randomArray(suite,size,layout);
+        const char *detail=check::layoutName(layout);
+
+        int min_value, max_value;
+        double avg;
+        sequential_min(v,min_value);
+        sequential_max(v,max_value);
+        long long sum=sequential_sum(v);
+        sequential_avg(v,avg);
+
+        auto expect=[&](const char *name,bool ok)
+        {
+            suite.expect(ok,check::describe(name,size,detail));
+        };
+        int m;
+        long long s;
+        double a;
+        if(suite.wants("Parallel Minimum"))
+        {
+            parallel_min(v,m);
+            expect("Parallel Minimum",m==min_value);
+        }
+        if(suite.wants("Parallel Maximum"))
+        {
+            parallel_max(v,m);
+            expect("Parallel Maximum",m==max_value);
+        }
+        if(suite.wants("Parallel Sum"))
+        {
+            s=parallel_sum(v);
+            expect("Parallel Sum",s==sum);
+        }
+        if(suite.wants("Parallel Average"))
+        {
+            parallel_avg(v,a);
+            expect("Parallel Average",a==avg);
+        }
+        if(suite.wants("Pool Minimum"))
+        {
+            pool_min(v,m);
+            expect("Pool Minimum",m==min_value);
+        }
+        if(suite.wants("Pool Maximum"))
+        {
+            pool_max(v,m);
+            expect("Pool Maximum",m==max_value);
+        }
+        if(suite.wants("Pool Sum"))
+        {
+            s=pool_sum(v);
+            expect("Pool Sum",s==sum);
+        }
+        if(suite.wants("Pool Average"))
+        {
+            pool_avg(v,a);
+            expect("Pool Average",a==avg);
+        }
+    });
+
+    return suite.finish();
+}
 
-    int size=1000000;
-    vector<int>v(size);
-    for(int i=0;i<size;i++)
+int main(int argc, char **argv)
+{
+    // ./output3 [--sizes=1000000] [--threads=1,2,4] [--format=text|json|csv] (see common/benchmark.h)
+    // ./output3 --verify [--threads=4] [--rounds=20] [--seed=1] (see common/verify.h)
+    bench::Options opts;
+    if(!bench::parseOptions(argc,argv,opts,{1000000}))
+    {
+        return 1;
+    }
+    if(opts.has("verify"))
     {
-        v[i]=size-i;
+        return verify(opts);
     }
+    bench::Report report("hpc3",opts);
 
-    int min_value, max_value;
-    long long sum;
-    double avg;
+    bench::sweep(opts,[&](long size)
+    {
+        // vector<int> v={10,9,8,7,6,5,4,3,2,1};
 
-    cout<<"--------------------Sequential Algorithms-----------------------"<<endl;
+        vector<int>v(size);
+        for(int i=0;i<size;i++)
+        {
+            v[i]=size-i;
+        }
 
-    auto start=high_resolution_clock::now();
-    sequential_min(v,min_value);
-    auto end=high_resolution_clock::now();
-    auto time_min=duration_cast<milliseconds>(end-start).count();
+        int min_value, max_value;
+        long long sum;
+        double avg;
 
-    start=high_resolution_clock::now();
-    sequential_max(v,max_value);
-    end=high_resolution_clock::now();
-    auto time_max=duration_cast<milliseconds>(end-start).count();
+        if(opts.text())
+        {
+            cout<<"--------------------Sequential Algorithms-----------------------"<<endl;
+        }
 
-    start=high_resolution_clock::now();
-    sum=sequential_sum(v);
-    end=high_resolution_clock::now();
-    auto time_sum=duration_cast<milliseconds>(end-start).count();
+        report.run("Sequential Minimum",size,size,"elements/s",[&]{ sequential_min(v,min_value); });
+        report.run("Sequential Maximum",size,size,"elements/s",[&]{ sequential_max(v,max_value); });
+        report.run("Sequential Sum",size,size,"elements/s",[&]{ sum=sequential_sum(v); });
+        report.run("Sequential Average",size,size,"elements/s",[&]{ sequential_avg(v,avg); });
 
-    start=high_resolution_clock::now();
-    sequential_avg(v,avg);
-    end=high_resolution_clock::now();
-    auto time_avg=duration_cast<milliseconds>(end-start).count();
+        if(opts.text())
+        {
+            cout<<"Sequential Minimum: "<<min_value<<endl;
+            cout<<"Sequential Maximum: "<<max_value<<endl;
+            cout<<"Sequential Sum: "<<sum<<endl;
+            cout<<"Sequential Average: "<<avg<<endl;
+            cout<<"----------------------------------------------------------------"<<endl;
+        }
 
-    cout<<"Sequential Minimum: "<<min_value<<"\t Time: "<<time_min<<" ms"<<endl;
-    cout<<"Sequential Maximum: "<<max_value<<"\t Time: "<<time_max<<" ms"<<endl;
-    cout<<"Sequential Sum: "<<sum<<"\t Time: "<<time_sum<<" ms"<<endl;
-    cout<<"Sequential Average: "<<avg<<"\t Time: "<<time_avg<<" ms"<<endl;
-    cout<<"----------------------------------------------------------------"<<endl;
-    
 
 
 
+        min_value=INT_MAX;
+        max_value=INT_MIN;
+        sum=0;
+        avg=0.0;
 
-    min_value=INT_MAX;
-    max_value=INT_MIN;
-    sum=0;
-    avg=0.0;
 
 
 
+        if(opts.text())
+        {
+            cout<<"--------------------Parallel Algorithms-------------------------"<<endl;
+        }
+
+        report.run("Parallel Minimum",size,size,"elements/s",[&]{ parallel_min(v,min_value); });
+        report.run("Parallel Maximum",size,size,"elements/s",[&]{ parallel_max(v,max_value); });
+        report.run("Parallel Sum",size,size,"elements/s",[&]{ sum=parallel_sum(v); });
+        report.run("Parallel Average",size,size,"elements/s",[&]{ parallel_avg(v,avg); });
+
+        if(opts.text())
+        {
+            cout<<"Parallel Minimum: "<<min_value<<endl;
+            cout<<"Parallel Maximum: "<<max_value<<endl;
+            cout<<"Parallel Sum: "<<sum<<endl;
+            cout<<"Parallel Average: "<<avg<<endl;
+            cout<<"----------------------------------------------------------------"<<endl;
+        }
+
+
 
-    cout<<"--------------------Parallel Algorithms-------------------------"<<endl;
 
-    start=high_resolution_clock::now();
-    parallel_min(v,min_value);
-    end=high_resolution_clock::now();
-    time_min=duration_cast<milliseconds>(end-start).count();
+        min_value=INT_MAX;
+        max_value=INT_MIN;
+        sum=0;
+        avg=0.0;
 
-    start=high_resolution_clock::now();
-    parallel_max(v,max_value);
-    end=high_resolution_clock::now();
-    time_max=duration_cast<milliseconds>(end-start).count();
 
-    start=high_resolution_clock::now();
-    sum=parallel_sum(v);
-    end=high_resolution_clock::now();
-    time_sum=duration_cast<milliseconds>(end-start).count();
 
-    start=high_resolution_clock::now();
-    parallel_avg(v,avg);
-    end=high_resolution_clock::now();
-    time_avg=duration_cast<milliseconds>(end-start).count();
 
-    cout<<"Parallel Minimum: "<<min_value<<"\t Time: "<<time_min<<" ms"<<endl;
-    cout<<"Parallel Maximum: "<<max_value<<"\t Time: "<<time_max<<" ms"<<endl;
-    cout<<"Parallel Sum: "<<sum<<"\t Time: "<<time_sum<<" ms"<<endl;
-    cout<<"Parallel Average: "<<avg<<"\t Time: "<<time_avg<<" ms"<<endl;
-    cout<<"----------------------------------------------------------------"<<endl;
+        if(opts.text())
+        {
+            cout<<"--------------------Pool Algorithms-----------------------------"<<endl;
+        }
 
+        report.run("Pool Minimum",size,size,"elements/s",[&]{ pool_min(v,min_value); });
+        report.run("Pool Maximum",size,size,"elements/s",[&]{ pool_max(v,max_value); });
+        report.run("Pool Sum",size,size,"elements/s",[&]{ sum=pool_sum(v); });
+        report.run("Pool Average",size,size,"elements/s",[&]{ pool_avg(v,avg); });
+
+        if(opts.text())
+        {
+            cout<<"Pool Minimum: "<<min_value<<endl;
+            cout<<"Pool Maximum: "<<max_value<<endl;
+            cout<<"Pool Sum: "<<sum<<endl;
+            cout<<"Pool Average: "<<avg<<endl;
+            cout<<"----------------------------------------------------------------"<<endl;
+        }
+    });
+
+    report.finish();
     return 0;
 }
 
@@ -170,6 +338,16 @@ int main()
 
 
 /*
+Build & benchmark options:-
+g++-14 -O2 -fopenmp -o output3 hpc3.cpp
+./output3 --sizes=1000000,10000000 --threads=1,2,4 --format=json --output=hpc3.json
+
+With hardware counters and per-thread work/wait times (Linux):-
+g++-14 -O2 -fopenmp -DHPC_PERF -o output3 hpc3.cpp
+
+The "Pool" cases run on common/thread_pool.h. --verify and the ThreadSanitizer
+build are described in common/verify.h.
+
 Output-1 :-
 g++-14 -fopenmp -o output3 hpc3.cpp
 ./output3                       
@@ -0,0 +1,419 @@
+/*
+Shared benchmark harness for hpc1-hpc4.
+
+Every case gets warm-up runs and is then sampled until a target time has
+elapsed, and the median/p95/mean/stddev are reported in nanoseconds together
+with a throughput figure (elements/s, edges/s, GFLOP/s). Input sizes and
+thread counts are swept from the command line, and results can be written as
+text, JSON or CSV so speedup curves can be tracked across commits.
+
+Common flags:
+  --sizes=1000,10000     input sizes to sweep (meaning is program specific)
+  --threads=1,2,4        OpenMP thread counts to sweep (default: max threads)
+  --min-time=500         target measuring time per case in ms
+  --warmup=1             untimed runs before sampling
+  --samples=5            minimum samples per case
+  --max-samples=1000     maximum samples per case
+  --format=text          text | json | csv
+  --output=file          write the report to a file instead of stdout
+Any other --name=value flag is kept for the program to read with get()/has().
+
+Build with -DBENCH_COMMIT="\"$(git rev-parse --short HEAD)\"" to tag reports, and
+with -DHPC_PERF to add hardware counters to every case (see perf_counters.h).
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "perf_counters.h"
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+
+namespace bench
+{
+
+struct Options
+{
+    std::vector<long> sizes;
+    std::vector<int> threads;
+    double minTimeMs = 500;
+    int warmup = 1;
+    int minSamples = 5;
+    int maxSamples = 1000;
+    std::string format = "text";
+    std::string output;
+    std::map<std::string, std::string> extra;
+
+    bool has(const std::string &name) const { return extra.count(name) > 0; }
+
+    double get(const std::string &name, double fallback) const
+    {
+        auto it = extra.find(name);
+        return it == extra.end() ? fallback : atof(it->second.c_str());
+    }
+
+    std::string str(const std::string &name, const std::string &fallback = "") const
+    {
+        auto it = extra.find(name);
+        return it == extra.end() ? fallback : it->second;
+    }
+
+    bool text() const { return format == "text"; }
+};
+
+template <typename T>
+std::vector<T> parseList(const std::string &list)
+{
+    std::vector<T> values;
+    std::stringstream in(list);
+    std::string item;
+    while (getline(in, item, ','))
+        if (!item.empty())
+            values.push_back((T)atof(item.c_str()));
+    return values;
+}
+
+// Fills opts from argv; sizes default to defaultSizes. Returns false (after
+// printing the reason) on a malformed flag.
+inline bool parseOptions(int argc, char **argv, Options &opts, const std::vector<long> &defaultSizes)
+{
+    opts.sizes = defaultSizes;
+    opts.threads = {omp_get_max_threads()};
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            std::cerr << "Unexpected argument: " << arg << "\n";
+            return false;
+        }
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+        std::string value = eq == std::string::npos ? "1" : arg.substr(eq + 1);
+
+        if (name == "sizes")
+            opts.sizes = parseList<long>(value);
+        else if (name == "threads")
+            opts.threads = parseList<int>(value);
+        else if (name == "min-time")
+            opts.minTimeMs = atof(value.c_str());
+        else if (name == "warmup")
+            opts.warmup = atoi(value.c_str());
+        else if (name == "samples")
+            opts.minSamples = std::max(1, atoi(value.c_str()));
+        else if (name == "max-samples")
+            opts.maxSamples = std::max(1, atoi(value.c_str()));
+        else if (name == "format")
+            opts.format = value;
+        else if (name == "output")
+            opts.output = value;
+        else
+            opts.extra[name] = value;
+    }
+
+    if (opts.format != "text" && opts.format != "json" && opts.format != "csv")
+    {
+        std::cerr << "Unknown --format=" << opts.format << " (expected text, json or csv)\n";
+        return false;
+    }
+    if (opts.sizes.empty() || opts.threads.empty())
+    {
+        std::cerr << "--sizes and --threads need at least one value\n";
+        return false;
+    }
+    return true;
+}
+
+struct Stats
+{
+    int samples = 0;
+    double medianNs = 0;
+    double p95Ns = 0;
+    double meanNs = 0;
+    double stddevNs = 0;
+    double minNs = 0;
+};
+
+inline Stats summarize(std::vector<double> ns)
+{
+    Stats s;
+    s.samples = ns.size();
+    if (ns.empty())
+        return s;
+
+    sort(ns.begin(), ns.end());
+    size_t n = ns.size();
+    s.minNs = ns[0];
+    s.medianNs = n % 2 ? ns[n / 2] : (ns[n / 2 - 1] + ns[n / 2]) / 2;
+    s.p95Ns = ns[std::min(n - 1, (size_t)std::ceil(0.95 * n) - 1)];
+    for (double x : ns)
+        s.meanNs += x / n;
+    for (double x : ns)
+        s.stddevNs += (x - s.meanNs) * (x - s.meanNs);
+    s.stddevNs = n > 1 ? std::sqrt(s.stddevNs / (n - 1)) : 0;
+    return s;
+}
+
+inline double nowNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Times fn. setup, if given, runs untimed before every call (for example to
+// restore an unsorted input). Without setup, calls shorter than ~10 us are
+// batched so each sample is long enough for the clock to resolve. The batch
+// is sized from the last warm-up call, or from the first sample when there is
+// no warm-up, so slow cases never pay for an extra calibration call.
+inline Stats measure(const Options &opts, const std::function<void()> &fn,
+                     const std::function<void()> &setup = nullptr)
+{
+    double once = -1;
+    for (int i = 0; i < opts.warmup; i++)
+    {
+        if (setup)
+            setup();
+        double t0 = nowNs();
+        fn();
+        once = nowNs() - t0;
+    }
+
+    std::vector<double> samples;
+    double spent = 0;
+    int batch = 1;
+    if (!setup)
+    {
+        if (once < 0)
+        {
+            double t0 = nowNs();
+            fn();
+            once = nowNs() - t0;
+            if (once >= 10000)
+            {
+                samples.push_back(once);
+                spent += once;
+            }
+        }
+        if (once < 10000)
+            batch = std::max(1, std::min(1 << 20, (int)(10000 / std::max(1.0, once))));
+    }
+
+    while ((int)samples.size() < opts.maxSamples &&
+           ((int)samples.size() < opts.minSamples || spent < opts.minTimeMs * 1e6))
+    {
+        if (setup)
+            setup();
+        double t0 = nowNs();
+        for (int i = 0; i < batch; i++)
+            fn();
+        double t = nowNs() - t0;
+        spent += t;
+        samples.push_back(t / batch);
+    }
+    return summarize(samples);
+}
+
+struct Result
+{
+    std::string name;
+    long size;
+    int threads;
+    Stats stats;
+    double throughput;
+    std::string unit;
+#ifdef HPC_PERF
+    perf::Counts counters;
+#endif
+};
+
+// Collects results for one program. Text output is printed as cases finish;
+// JSON and CSV are written by finish().
+class Report
+{
+    std::string program;
+    const Options &opts;
+    std::vector<Result> results;
+
+    Result newResult(const std::string &name, long size, const std::string &unit) const
+    {
+        Result r;
+        r.name = name;
+        r.size = size;
+        r.threads = omp_get_max_threads();
+        r.unit = unit;
+        return r;
+    }
+
+    // Fills in the throughput, stores r and prints it in text mode.
+    const Result &add(Result &r, double work)
+    {
+        r.throughput = r.stats.medianNs > 0 ? work / (r.stats.medianNs * 1e-9) : 0;
+        results.push_back(r);
+
+        if (opts.text())
+        {
+            std::cout << r.name << " Time: " << r.stats.medianNs / 1e6 << " ms (median of " << r.stats.samples
+                      << ", p95 " << r.stats.p95Ns / 1e6 << " ms, stddev " << r.stats.stddevNs / 1e6 << " ms, "
+                      << r.throughput << " " << r.unit << ")\n";
+#ifdef HPC_PERF
+            std::cout << "    perf: " << perf::formatCounters(r.counters) << "\n"
+                      << "    thread work/wait ms: " << perf::formatThreads(r.counters) << "\n";
+#endif
+        }
+        return results.back();
+    }
+
+public:
+    Report(const std::string &program, const Options &opts) : program(program), opts(opts) {}
+
+    // work is the amount done by one call in the unit's numerator, e.g. the
+    // element count for "elements/s" or flops / 1e9 for "GFLOP/s".
+    const Result &run(const std::string &name, long size, double work, const std::string &unit,
+                      const std::function<void()> &fn, const std::function<void()> &setup = nullptr)
+    {
+        Result r = newResult(name, size, unit);
+        r.stats = measure(opts, fn, setup);
+
+#ifdef HPC_PERF
+        if (setup)
+            setup();
+        perf::Region region;
+        region.start();
+        fn();
+        r.counters = region.stop();
+#endif
+        return add(r, work);
+    }
+
+    // Like run(), but times a single call with no warm-up, whatever the
+    // options say. For slow baselines (a naive O(N^3) loop) that a full
+    // measure() would spend minutes on.
+    const Result &runOnce(const std::string &name, long size, double work, const std::string &unit,
+                          const std::function<void()> &fn)
+    {
+        Result r = newResult(name, size, unit);
+#ifdef HPC_PERF
+        perf::Region region;
+        region.start();
+#endif
+        double t0 = nowNs();
+        fn();
+        r.stats = summarize({nowNs() - t0});
+#ifdef HPC_PERF
+        r.counters = region.stop();
+#endif
+        return add(r, work);
+    }
+
+    const std::vector<Result> &all() const { return results; }
+
+    void finish() const
+    {
+        if (opts.text())
+            return;
+
+        std::ofstream file;
+        if (!opts.output.empty())
+            file.open(opts.output);
+        std::ostream &out = opts.output.empty() ? std::cout : file;
+
+        if (opts.format == "csv")
+        {
+            out << "program,commit,name,size,threads,samples,median_ns,p95_ns,mean_ns,stddev_ns,min_ns,throughput,unit";
+#ifdef HPC_PERF
+            for (int i = 0; i < perf::numCounters; i++)
+                out << "," << perf::counterNames[i];
+            out << ",work_ns,wait_ns";
+#endif
+            out << "\n";
+            for (const Result &r : results)
+            {
+                out << program << "," << BENCH_COMMIT << ",\"" << r.name << "\"," << r.size << "," << r.threads
+                    << "," << r.stats.samples << "," << r.stats.medianNs << "," << r.stats.p95Ns << ","
+                    << r.stats.meanNs << "," << r.stats.stddevNs << "," << r.stats.minNs << "," << r.throughput
+                    << "," << r.unit;
+#ifdef HPC_PERF
+                double work = 0, wait = 0;
+                for (size_t t = 0; t < r.counters.workNs.size(); t++)
+                {
+                    work += r.counters.workNs[t];
+                    wait += r.counters.waitNs[t];
+                }
+                for (int i = 0; i < perf::numCounters; i++)
+                {
+                    out << ",";
+                    if (r.counters.valid[i])
+                        out << r.counters.value[i];
+                }
+                out << "," << work << "," << wait;
+#endif
+                out << "\n";
+            }
+            return;
+        }
+
+        out << "{\n  \"program\": \"" << program << "\",\n  \"commit\": \"" << BENCH_COMMIT
+            << "\",\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result &r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"size\": " << r.size << ", \"threads\": " << r.threads
+                << ", \"samples\": " << r.stats.samples << ", \"median_ns\": " << r.stats.medianNs
+                << ", \"p95_ns\": " << r.stats.p95Ns << ", \"mean_ns\": " << r.stats.meanNs
+                << ", \"stddev_ns\": " << r.stats.stddevNs << ", \"min_ns\": " << r.stats.minNs
+                << ", \"throughput\": " << r.throughput << ", \"unit\": \"" << r.unit << "\"";
+#ifdef HPC_PERF
+            out << ", \"perf\": {";
+            for (int c = 0; c < perf::numCounters; c++)
+            {
+                out << (c ? ", " : "") << "\"" << perf::counterNames[c] << "\": ";
+                if (r.counters.valid[c])
+                    out << r.counters.value[c];
+                else
+                    out << "null";
+            }
+            out << ", \"work_ns\": [";
+            for (size_t t = 0; t < r.counters.workNs.size(); t++)
+                out << (t ? ", " : "") << r.counters.workNs[t];
+            out << "], \"wait_ns\": [";
+            for (size_t t = 0; t < r.counters.waitNs.size(); t++)
+                out << (t ? ", " : "") << r.counters.waitNs[t];
+            out << "]}";
+#endif
+            out << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+};
+
+// Calls body(size) for every size at every thread count in opts.
+template <typename Body>
+void sweep(const Options &opts, Body body)
+{
+    for (int threads : opts.threads)
+    {
+        omp_set_num_threads(threads);
+        for (long size : opts.sizes)
+        {
+            if (opts.text())
+                std::cout << "==================== size " << size << ", " << threads << " threads ====================\n";
+            body(size);
+        }
+    }
+}
+
+} // namespace bench
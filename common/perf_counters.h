@@ -0,0 +1,267 @@
+/*
+Optional hardware performance counters for the benchmark harness.
+
+Build with -DHPC_PERF to enable. Every benchmark case then gets one extra,
+untimed run inside a perf::Region. The region collects cycles, instructions,
+cache misses, branch misses and context switches through Linux
+perf_event_open, plus a per-thread split of time inside parallel regions into
+work and wait. Without HPC_PERF nothing here is compiled in: the macros expand
+to nothing and no counters are opened.
+
+Instrumenting a parallel region:
+    #pragma omp parallel
+    {
+        HPC_PERF_THREAD();              // this thread's time in the region
+        #pragma omp for nowait
+        for (...)
+        {
+            HPC_PERF_WAIT_START(t);     // time spent waiting to enter
+            #pragma omp critical
+            {
+                HPC_PERF_WAIT_STOP(t);
+                ...
+            }
+        }
+        HPC_PERF_BARRIER();             // timed barrier, HPC_PERF only
+    }
+
+HPC_PERF_BARRIER() is an explicit barrier only in HPC_PERF builds, where it
+moves the wait for the slowest thread out of the region's closing barrier and
+into the timed wait; that closing barrier then finds every thread already
+arrived. Otherwise it is empty and the closing barrier is the only one, so the
+instrumented region costs the same as a plain 'parallel for'.
+
+Counters are per thread and are summed over the OpenMP team. Worker threads
+that never entered an HPC_PERF_THREAD scope during the region are left out,
+so idle workers do not inflate the counts of sequential code. Threads created
+by nested parallel regions are not counted.
+*/
+#pragma once
+
+#include <omp.h>
+
+#ifdef HPC_PERF
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace perf
+{
+
+const int numCounters = 5;
+const char *const counterNames[numCounters] = {"cycles", "instructions", "cache-misses", "branch-misses",
+                                               "context-switches"};
+
+inline double nowNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline int openCounter(int index)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    const uint64_t hardware[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                 PERF_COUNT_HW_BRANCH_MISSES};
+    if (index < 4)
+    {
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = hardware[index];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+    }
+    else
+    {
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+    }
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Counter file descriptors and timers of one OS thread. The counters are
+// opened the first time the thread takes part in a region and kept open.
+struct ThreadState
+{
+    int fd[numCounters];
+    bool opened = false;
+    int depth = 0;
+    double scopeStart = 0;
+    double activeNs = 0;
+    double waitNs = 0;
+
+    void open()
+    {
+        if (opened)
+            return;
+        for (int i = 0; i < numCounters; i++)
+            fd[i] = openCounter(i);
+        opened = true;
+    }
+};
+
+inline ThreadState &threadState()
+{
+    static thread_local ThreadState state;
+    return state;
+}
+
+// Adds the thread's time in its outermost instrumented parallel region to
+// activeNs; nested (serialized) regions on the same thread are not counted twice.
+struct ThreadScope
+{
+    ThreadScope()
+    {
+        ThreadState &s = threadState();
+        if (s.depth++ == 0)
+            s.scopeStart = nowNs();
+    }
+
+    ~ThreadScope()
+    {
+        ThreadState &s = threadState();
+        if (--s.depth == 0)
+            s.activeNs += nowNs() - s.scopeStart;
+    }
+};
+
+inline void addWait(double ns)
+{
+    threadState().waitNs += ns;
+}
+
+struct Counts
+{
+    double value[numCounters] = {};
+    bool valid[numCounters] = {};
+    std::vector<double> workNs;
+    std::vector<double> waitNs;
+};
+
+class Region
+{
+public:
+    void start()
+    {
+        #pragma omp parallel
+        {
+            ThreadState &s = threadState();
+            s.open();
+            s.activeNs = s.waitNs = 0;
+            for (int i = 0; i < numCounters; i++)
+            {
+                if (s.fd[i] >= 0)
+                {
+                    ioctl(s.fd[i], PERF_EVENT_IOC_RESET, 0);
+                    ioctl(s.fd[i], PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+        }
+    }
+
+    Counts stop()
+    {
+        Counts counts;
+        for (int i = 0; i < numCounters; i++)
+            counts.valid[i] = true;
+        counts.workNs.assign(omp_get_max_threads(), 0);
+        counts.waitNs.assign(omp_get_max_threads(), 0);
+
+        #pragma omp parallel
+        {
+            ThreadState &s = threadState();
+            int t = omp_get_thread_num();
+            bool counted = t == 0 || s.activeNs > 0;
+            double value[numCounters];
+            bool valid[numCounters];
+
+            for (int i = 0; i < numCounters; i++)
+            {
+                uint64_t data[3] = {0, 0, 0}; // value, time enabled, time running
+                valid[i] = s.fd[i] >= 0;
+                if (valid[i])
+                {
+                    ioctl(s.fd[i], PERF_EVENT_IOC_DISABLE, 0);
+                    valid[i] = read(s.fd[i], data, sizeof(data)) == sizeof(data);
+                }
+                // Scale up if the kernel multiplexed the counter.
+                value[i] = data[2] > 0 ? double(data[0]) * data[1] / data[2] : double(data[0]);
+            }
+
+            if (t < (int)counts.workNs.size())
+            {
+                counts.workNs[t] = s.activeNs - s.waitNs;
+                counts.waitNs[t] = s.waitNs;
+            }
+
+            #pragma omp critical(hpc_perf_counts)
+            {
+                for (int i = 0; i < numCounters; i++)
+                {
+                    counts.valid[i] = counts.valid[i] && valid[i];
+                    if (counted)
+                        counts.value[i] += value[i];
+                }
+            }
+        }
+        return counts;
+    }
+};
+
+// One-line summaries used by the harness.
+inline std::string formatCounters(const Counts &c)
+{
+    std::ostringstream out;
+    for (int i = 0; i < numCounters; i++)
+    {
+        out << (i ? ", " : "") << counterNames[i] << " ";
+        if (c.valid[i])
+            out << (long long)c.value[i];
+        else
+            out << "n/a";
+    }
+    if (c.valid[0] && c.valid[1] && c.value[0] > 0)
+        out << ", IPC " << c.value[1] / c.value[0];
+    return out.str();
+}
+
+inline std::string formatThreads(const Counts &c)
+{
+    std::ostringstream out;
+    for (size_t t = 0; t < c.workNs.size(); t++)
+        out << (t ? ", " : "") << "t" << t << " " << c.workNs[t] / 1e6 << "/" << c.waitNs[t] / 1e6;
+    return out.str();
+}
+
+} // namespace perf
+
+#define HPC_PERF_THREAD() perf::ThreadScope hpcPerfThreadScope
+#define HPC_PERF_WAIT_START(var) double var = perf::nowNs()
+#define HPC_PERF_WAIT_STOP(var) perf::addWait(perf::nowNs() - (var))
+#define HPC_PERF_BARRIER()                                              \
+    do                                                                  \
+    {                                                                   \
+        HPC_PERF_WAIT_START(hpcPerfBarrierStart);                       \
+        _Pragma("omp barrier") HPC_PERF_WAIT_STOP(hpcPerfBarrierStart); \
+    } while (0)
+
+#else
+
+#define HPC_PERF_THREAD() ((void)0)
+#define HPC_PERF_WAIT_START(var) ((void)0)
+#define HPC_PERF_WAIT_STOP(var) ((void)0)
+#define HPC_PERF_BARRIER() ((void)0)
+
+#endif
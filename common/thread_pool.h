@@ -0,0 +1,361 @@
+/*
+Persistent work-stealing thread pool shared by hpc1-hpc3.
+
+Workers are started once and kept, so a parallel loop or a fork-join step
+costs a deque push and (at most) a wake-up instead of an OpenMP region. Every
+worker owns a deque: it pushes and pops its own tasks at the back (LIFO, for
+locality) and steals from the front of a random victim when it runs dry. A
+thread waiting on a TaskGroup runs queued tasks instead of blocking, so
+recursive fork-join (merge sort) cannot deadlock. The calling thread counts
+as worker 0.
+
+    tp::TaskGroup g;                       // fork-join
+    g.run([&] { left(); });
+    right();
+    g.wait();
+
+    tp::parallel_for(0, n, [&](long lo, long hi) { ... });     // adaptive grain
+    T r = tp::parallel_reduce(0, n, T(0), body, combine);
+
+parallel_for uses lazy binary splitting: a range is halved (and the upper
+half offered to thieves) only while the current worker's deque is empty, so
+small or already well-distributed loops run inline without spawning. The
+pool is sized to omp_get_max_threads() and rebuilt when that changes, so the
+harness's --threads sweep applies to it. Workers are pinned to CPUs of the
+process affinity mask; set HPC_POOL_PIN=0 to disable.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <omp.h>
+#include <pthread.h>
+#include <sched.h>
+
+namespace tp
+{
+
+class TaskGroup;
+
+struct Task
+{
+    std::function<void()> fn;
+    TaskGroup *group;
+};
+
+class TaskGroup
+{
+    friend class ThreadPool;
+    std::atomic<int> pending{0};
+
+public:
+    template <typename F>
+    void run(F &&fn);
+    void wait();
+};
+
+class ThreadPool
+{
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<int> queued{0};
+    std::atomic<int> sleepers{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepLock;
+    std::condition_variable wake;
+
+    static int &currentIndex()
+    {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    // Worker slot of the calling thread; threads outside the pool use slot 0.
+    int self() const
+    {
+        int index = currentIndex();
+        return index >= 0 && index < (int)workers.size() ? index : 0;
+    }
+
+    bool popLocal(int w, Task &task)
+    {
+        Worker &worker = *workers[w];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (worker.tasks.empty())
+            return false;
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        queued--;
+        return true;
+    }
+
+    bool steal(int w, Task &task)
+    {
+        int n = workers.size();
+        int start = rand_r(&seed()) % n;
+        for (int k = 0; k < n; k++)
+        {
+            int victim = (start + k) % n;
+            if (victim == w)
+                continue;
+            Worker &worker = *workers[victim];
+            std::lock_guard<std::mutex> guard(worker.lock);
+            if (!worker.tasks.empty())
+            {
+                task = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static unsigned &seed()
+    {
+        static thread_local unsigned s = std::hash<std::thread::id>()(std::this_thread::get_id());
+        return s;
+    }
+
+    void execute(Task &task)
+    {
+        task.fn();
+        task.group->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    static void pin(int cpuSlot)
+    {
+        const char *env = getenv("HPC_POOL_PIN");
+        if (env && atoi(env) == 0)
+            return;
+
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+            return;
+        int target = cpuSlot % CPU_COUNT(&allowed);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &allowed) && target-- == 0)
+            {
+                cpu_set_t one;
+                CPU_ZERO(&one);
+                CPU_SET(cpu, &one);
+                pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+                return;
+            }
+        }
+    }
+
+    void workerLoop(int w)
+    {
+        currentIndex() = w;
+        pin(w);
+
+        Task task;
+        while (!stopping.load(std::memory_order_acquire))
+        {
+            if (runOne(w, task))
+                continue;
+
+            // Spin briefly before sleeping: fork-join steps are short.
+            bool found = false;
+            for (int spin = 0; spin < 2000 && !found; spin++)
+            {
+                if (queued.load(std::memory_order_relaxed) > 0)
+                    found = runOne(w, task);
+                else
+                    std::this_thread::yield();
+            }
+            if (found)
+                continue;
+
+            std::unique_lock<std::mutex> guard(sleepLock);
+            sleepers++;
+            wake.wait(guard, [&] { return queued.load() > 0 || stopping.load(); });
+            sleepers--;
+        }
+    }
+
+public:
+    explicit ThreadPool(int size)
+    {
+        size = std::max(1, size);
+        for (int w = 0; w < size; w++)
+            workers.emplace_back(new Worker);
+        for (int w = 1; w < size; w++)
+            threads.emplace_back(&ThreadPool::workerLoop, this, w);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : threads)
+            t.join();
+    }
+
+    int size() const { return workers.size(); }
+
+    static bool onWorkerThread() { return currentIndex() > 0; }
+
+    void push(Task task)
+    {
+        int w = self();
+        {
+            std::lock_guard<std::mutex> guard(workers[w]->lock);
+            workers[w]->tasks.push_back(std::move(task));
+        }
+        queued++;
+        if (sleepers.load() > 0)
+        {
+            {
+                std::lock_guard<std::mutex> guard(sleepLock);
+            }
+            wake.notify_one();
+        }
+    }
+
+    // Runs one task from the local deque or a victim's; false if none found.
+    bool runOne(int w, Task &task)
+    {
+        if (popLocal(w, task) || steal(w, task))
+        {
+            execute(task);
+            return true;
+        }
+        return false;
+    }
+
+    bool runOne()
+    {
+        Task task;
+        return runOne(self(), task);
+    }
+
+    bool localEmpty()
+    {
+        Worker &worker = *workers[self()];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        return worker.tasks.empty();
+    }
+};
+
+// The shared pool, sized to the calling thread's omp_get_max_threads(). Only
+// the owning (non-worker) thread may resize it, between parallel operations.
+inline ThreadPool &pool()
+{
+    static std::unique_ptr<ThreadPool> instance;
+    if (instance && ThreadPool::onWorkerThread())
+        return *instance;
+
+    int size = omp_get_max_threads();
+    if (!instance || instance->size() != size)
+    {
+        instance.reset();
+        instance.reset(new ThreadPool(size));
+    }
+    return *instance;
+}
+
+template <typename F>
+void TaskGroup::run(F &&fn)
+{
+    pending.fetch_add(1, std::memory_order_relaxed);
+    pool().push(Task{std::function<void()>(std::forward<F>(fn)), this});
+}
+
+inline void TaskGroup::wait()
+{
+    ThreadPool &p = pool();
+    while (pending.load(std::memory_order_acquire) > 0)
+    {
+        if (!p.runOne())
+            std::this_thread::yield();
+    }
+}
+
+// Below this many iterations a loop is not worth splitting unless the caller
+// passes an explicit grain.
+const long defaultMinGrain = 256;
+
+template <typename Body>
+void forRange(TaskGroup &group, long begin, long end, const Body &body, long grain)
+{
+    ThreadPool &p = pool();
+    while (end - begin > grain)
+    {
+        if (p.localEmpty())
+        {
+            long mid = begin + (end - begin) / 2;
+            group.run([&group, &body, mid, end, grain] { forRange(group, mid, end, body, grain); });
+            end = mid;
+        }
+        else
+        {
+            body(begin, begin + grain);
+            begin += grain;
+        }
+    }
+    body(begin, end);
+}
+
+// Calls body(lo, hi) over disjoint subranges covering [begin, end).
+template <typename Body>
+void parallel_for(long begin, long end, const Body &body, long grain = 0)
+{
+    long n = end - begin;
+    if (n <= 0)
+        return;
+
+    int workers = pool().size();
+    if (grain <= 0)
+        grain = std::max(defaultMinGrain, n / (8L * workers));
+    if (workers == 1 || n <= grain)
+    {
+        body(begin, end);
+        return;
+    }
+
+    TaskGroup group;
+    forRange(group, begin, end, body, grain);
+    group.wait();
+}
+
+// Folds body(lo, hi, init) over subranges of [begin, end) with combine.
+template <typename T, typename Body, typename Combine>
+T parallel_reduce(long begin, long end, T identity, const Body &body, const Combine &combine, long grain = 0)
+{
+    long n = end - begin;
+    int workers = pool().size();
+    if (grain <= 0)
+        grain = std::max(defaultMinGrain, n / (8L * workers));
+    if (workers == 1 || n <= grain)
+        return body(begin, end, identity);
+
+    long mid = begin + n / 2;
+    T left = identity;
+    TaskGroup group;
+    group.run([&] { left = parallel_reduce(begin, mid, identity, body, combine, grain); });
+    T right = parallel_reduce(mid, end, identity, body, combine, grain);
+    group.wait();
+    return combine(left, right);
+}
+
+} // namespace tp
@@ -0,0 +1,151 @@
+/*
+Randomized differential checks for hpc1-hpc4.
+
+Each program accepts --verify. Instead of benchmarking, it then generates
+random inputs (sizes, duplicates, presorted and adversarial layouts) and
+checks every parallel and pool variant against its sequential reference. The
+checks run at every thread count from 1 to N, where N is the largest --threads
+value (default: omp_get_max_threads()). Round r at every thread count uses the
+same input, so a failure reported as "seed S round R" can be reproduced with
+--seed=S.
+
+  --verify               run the checks and exit non-zero on any failure
+  --rounds=20            random inputs per thread count
+  --seed=1               base seed
+  --only=Pool            only run checks whose reported name contains this text
+
+Run it under ThreadSanitizer to catch races that happen to give the right
+answer. GCC's libgomp is not instrumented, so TSan cannot see its fork/join,
+barriers or critical sections and reports every OpenMP region. Link against
+LLVM's libomp instead (it implements the GOMP entry points GCC emits) and load
+its Archer tool, which reports OpenMP synchronization to TSan:
+  LLVM=/usr/lib/llvm-14/lib
+  g++ -O1 -g -fopenmp -fsanitize=thread -c hpc1.cpp -o verify1.o
+  g++ -fsanitize=thread verify1.o -o verify1 -L$LLVM -lomp -Wl,-rpath,$LLVM
+  OMP_TOOL_LIBRARIES=$LLVM/libarcher.so TSAN_OPTIONS=suppressions=../common/tsan.supp \
+      ./verify1 --verify --threads=4
+(add -march=native -x c++ for hpc4.cu). With clang, -fopenmp -fsanitize=thread
+links libomp directly. tsan.supp only covers a lock libomp initializes
+internally. The pool variants need none of this; --only=Pool checks them alone.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "benchmark.h"
+
+namespace check
+{
+
+class Suite
+{
+    std::string program;
+    std::string only;
+    unsigned seed;
+    int rounds;
+    int maxThreads;
+    int threads = 0;
+    int round = 0;
+    long checks = 0;
+    long failures = 0;
+
+public:
+    std::mt19937 rng;
+
+    Suite(const std::string &program, const bench::Options &opts)
+        : program(program), only(opts.str("only")), seed(opts.get("seed", 1)), rounds(std::max(1.0, opts.get("rounds", 20)))
+    {
+        maxThreads = *std::max_element(opts.threads.begin(), opts.threads.end());
+    }
+
+    // Uniform integer in [lo, hi].
+    int uniform(int lo, int hi) { return std::uniform_int_distribution<int>(lo, hi)(rng); }
+
+    // Calls body(round) for every round at thread counts 1..N. The RNG is
+    // reseeded per round, so the inputs do not depend on the thread count.
+    template <typename Body>
+    void sweep(Body body)
+    {
+        for (threads = 1; threads <= maxThreads; threads++)
+        {
+            omp_set_num_threads(threads);
+            for (round = 0; round < rounds; round++)
+            {
+                rng.seed(seed * 1000003u + round);
+                body(round);
+            }
+        }
+        threads = maxThreads;
+    }
+
+    // False for variants filtered out by --only.
+    bool wants(const std::string &name) const { return name.find(only) != std::string::npos; }
+
+    bool expect(bool ok, const std::string &what)
+    {
+        checks++;
+        if (!ok && failures++ < 50)
+            std::cerr << program << ": FAILED " << what << " (seed " << seed << " round " << round << ", "
+                      << threads << " threads)\n";
+        return ok;
+    }
+
+    // Prints the summary; returns the process exit code. A run that checked
+    // nothing (for example --only matched no variant) fails too.
+    int finish() const
+    {
+        std::cout << program << " verify: " << checks << " checks, " << failures << " failed (seed " << seed
+                  << ", " << rounds << " rounds, threads 1.." << maxThreads << ")\n";
+        if (checks == 0)
+            std::cerr << program << ": no checks matched --only=" << only << "\n";
+        return failures || checks == 0 ? 1 : 0;
+    }
+};
+
+// Array layouts that stress sorting and reductions differently.
+enum class Layout { Random, FewDistinct, Sorted, Reversed, Equal, OrganPipe, Sawtooth, Extremes, Count };
+
+inline const char *layoutName(Layout layout)
+{
+    const char *names[] = {"random", "few-distinct", "sorted", "reversed", "equal", "organ-pipe", "sawtooth",
+                           "extremes"};
+    return names[(int)layout];
+}
+
+inline std::vector<int> randomArray(Suite &suite, int n, Layout layout)
+{
+    std::vector<int> v(n);
+    for (int i = 0; i < n; i++)
+    {
+        switch (layout)
+        {
+        case Layout::FewDistinct: v[i] = suite.uniform(0, 3); break;
+        case Layout::Sorted: v[i] = i; break;
+        case Layout::Reversed: v[i] = n - i; break;
+        case Layout::Equal: v[i] = 7; break;
+        case Layout::OrganPipe: v[i] = std::min(i, n - i); break;
+        case Layout::Sawtooth: v[i] = i % 16; break;
+        case Layout::Extremes:
+            v[i] = suite.uniform(0, 1) ? INT32_MAX - suite.uniform(0, 2) : INT32_MIN + suite.uniform(0, 2);
+            break;
+        default: v[i] = suite.uniform(-1000000, 1000000); break;
+        }
+    }
+    return v;
+}
+
+// "what" for a failure message, e.g. describe("merge sort", n, layout).
+inline std::string describe(const std::string &name, long n, const char *detail = "")
+{
+    std::ostringstream out;
+    out << name << " n=" << n << (*detail ? " " : "") << detail;
+    return out.str();
+}
+
+} // namespace check